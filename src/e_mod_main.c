@@ -11,6 +11,10 @@
 #include <fcntl.h>
 #include <ctype.h>
 #include <syslog.h>
+#include <time.h>
+#include <limits.h>
+#include <stdint.h>
+#include <sys/stat.h>
 
 #ifndef STAND_ALONE
 #include <e.h>
@@ -26,7 +30,38 @@
 
 #define _EET_ENTRY "config"
 
-#define DELAY 0.01
+#define DEVICES_FILE "devices.conf"
+#define DEFAULT_PROFILE "default"
+
+#define DELAY 10000 /* us */
+
+/* Default busy-wait window of the precise timing mode */
+#define SPIN_DEFAULT 200 /* us */
+/* The busy-wait blocks the main loop, the compositor's one in E */
+#define SPIN_MAX 1000 /* us */
+
+/* Time given to the target to fetch the clipboard before it is restored */
+#define PASTE_DELAY 200000 /* us */
+
+/* Max wait for the previous content of the clipboard */
+#define PASTE_SAVE_TIMEOUT 0.1
+
+#define PASTE_CHORD_MAX 4
+
+/* Step by which the adaptive pacing shrinks the gap on each timely ack */
+#define PACE_STEP 1000 /* us */
+
+/* Lateness beyond which a scheduled run is considered as missed */
+#define SCHED_GRACE 5.0 /* s */
+
+/* Next fire time of a schedule that can't be satisfied */
+#define SCHED_NEVER 1e18
+
+/* Max refresh rate of the items while the scripts are being compiled */
+#define ITEMS_REFRESH_INTERVAL 0.1
+
+/* Refresh rate of the progress bars, kept low to not disturb the injection */
+#define PROGRESS_INTERVAL 0.5
 
 typedef struct
 {
@@ -38,13 +73,34 @@ typedef struct
    Eo *main_box;
 
    Eina_List *items;
-   Ecore_File_Monitor *config_dir_monitor;
-   Eina_Stringshare *cfg_path;
+} Instance;
 
-   int fd;
+/*
+ * A uinput device profile, declared in the devices.conf file of the
+ * config dir. The device itself is created on the first use.
+ */
+typedef struct
+{
+   Eina_Stringshare *profile;
+   char name[UINPUT_MAX_NAME_SIZE];
+   struct input_id id;
+   unsigned char keys[KEY_CNT / 8]; /* Keys and buttons bitmap */
+   unsigned char rels[REL_CNT / 8 + 1]; /* Relative axes bitmap */
+   int rep_delay, rep_period; /* ms, EV_REP is set if delay is not 0 */
+
+   int fd; /* -1 as long as the device is not created */
    struct input_event ev;
-   Eina_Hash *keys_map;
-} Instance;
+
+   /* Simulation: the events are written there instead of the device */
+   FILE *sim;
+   Eina_Bool sim_text;
+   unsigned long long clock; /* us, virtual time of the next events */
+   unsigned int sim_events;
+} Device;
+
+#define BIT_SET(map, bit) (map)[(bit) / 8] |= 1 << ((bit) % 8)
+#define BIT_TEST(map, bit) ((map)[(bit) / 8] & (1 << ((bit) % 8)))
+#define BIT_CLEAR(map, bit) (map)[(bit) / 8] &= ~(1 << ((bit) % 8))
 
 #define PRINT(fmt, ...) \
 { \
@@ -57,6 +113,22 @@ typedef struct
 static E_Module *_module = NULL;
 #endif
 
+/*
+ * State shared by all the gadget instances: the config dir and its
+ * monitor, the keys map and the cache of the compiled scripts.
+ */
+static Eina_List *_instances = NULL;
+static Eina_Stringshare *_cfg_path = NULL;
+static Ecore_File_Monitor *_config_dir_monitor = NULL;
+static Eina_Hash *_keys_map = NULL;
+static Eina_Hash *_scripts = NULL;
+static Eina_Hash *_devices = NULL;
+static Eina_Hash *_compile_jobs = NULL;
+/* Items waiting for the previous content of the clipboard */
+static Eina_List *_paste_waits = NULL;
+static unsigned int _paste_serial = 0;
+static Ecore_Timer *_items_refresh_timer = NULL;
+
 #define check_ret(ret) do{\
      if (ret < 0) {\
           PRINT("Error at %s:%d", __func__, __LINE__);\
@@ -64,95 +136,271 @@ static E_Module *_module = NULL;
      }\
 } while(0)
 
+typedef enum
+{
+   OP_KEY,
+   OP_KEY_DOWN,
+   OP_KEY_UP,
+   OP_DELAY,
+   OP_PASTE,
+   OP_HOLD,
+   OP_REPEAT
+} Op_Type;
+
+typedef struct
+{
+   Op_Type type;
+   int key;
+   unsigned long long delay; /* us to wait after the op */
+   unsigned long long offset; /* us from the beginning of the script */
+   Eina_Stringshare *text; /* OP_PASTE */
+   /*
+    * Steps of the op, the step i is at offset + i * stride.
+    * OP_HOLD has 2 steps, the press and the release. OP_REPEAT has one
+    * key stroke per step. The other ops have a single step.
+    */
+   unsigned int count;
+   unsigned int stride; /* us */
+} Script_Op;
+
+typedef enum
+{
+   SCHED_NONE,
+   SCHED_EVERY,
+   SCHED_CRON
+} Sched_Type;
+
+/* When a script has to be run, as given by its SCHEDULE line */
+typedef struct
+{
+   Sched_Type type;
+   unsigned int interval; /* s, SCHED_EVERY */
+   /* SCHED_CRON fields as bitmaps, dom and dow are ORed if both are set */
+   unsigned long long minutes;
+   unsigned int hours, mdays, months;
+   unsigned char wdays;
+   Eina_Bool mdays_any : 1;
+   Eina_Bool wdays_any : 1;
+
+   unsigned int jitter; /* s, random delay added to every run */
+   unsigned int max_concurrent;
+   Eina_Bool run_missed : 1; /* Run once a missed run instead of skipping it */
+   Eina_Bool queue_overlap : 1; /* Delay a run instead of skipping it if too many are running */
+} Schedule;
+
+typedef struct
+{
+   Eina_Stringshare *filename;
+   /* Identity of the recording when it has been read */
+   ino_t ino;
+   time_t mtime;
+   off_t size;
+} Script_Recording;
+
+typedef struct
+{
+   Eina_Stringshare *filename;
+   /* Identity of the file the script has been compiled from */
+   ino_t ino;
+   time_t mtime;
+   off_t size;
+   int refs; /* The cache holds one as long as the script is in it */
+   Eina_List *recordings; /* Script_Recording, their changes invalidate the script too */
+
+   Eina_Inarray *ops;
+   unsigned long long duration; /* us, sum of all the delays */
+   Eina_Bool precise; /* ops are fired at their absolute offset */
+   unsigned int spin; /* us busy-waited before a deadline in precise mode */
+   Eina_Bool adaptive; /* the gap after the keys follows the target */
+   unsigned int pace_min, pace_max; /* us, bounds of the adaptive gap */
+   Eina_Stringshare *device; /* Profile to play the script with */
+   int chord[PASTE_CHORD_MAX]; /* Keys injected to paste */
+   unsigned int chord_nb;
+   Schedule sched;
+} Script;
+
 typedef struct
 {
-   Instance *instance;
+   Instance *instance; /* NULL for the scheduled runs */
+   Device *device;
    Ecore_Timer *timer;
+   Ecore_Timer *progress_timer;
    Eina_Stringshare *filename;
    Eina_Stringshare *name;
    Eo *start_button;
+   Eo *progress;
    Eina_Bool playing;
-   char *filedata;
-   char *cur_filedata;
-   char *cur_state;
+   Eina_Bool scheduled;
+   Script *script;
+   unsigned int cur_op;
+   unsigned int cur_step; /* Next step of a strided op */
+   unsigned char keys_down[KEY_CNT / 8]; /* Pressed by KEY_DOWN, not released yet */
+   unsigned long long start_time; /* us */
+   unsigned long long late_sum; /* us */
+   unsigned int late_max; /* us */
+   unsigned int late_nb;
+
+   /* Adaptive pacing */
+   Evas *feedback_evas;
+   unsigned long long sent_time; /* us, last key waiting for an ack */
+   unsigned int gap; /* us */
+   unsigned int timeouts;
+   Eina_Bool ack_pending : 1;
+   Eina_Bool stalled : 1;
+
+   /* Paste in progress */
+   Script_Op *paste_op;
+   unsigned int paste_serial; /* Identifies the request of the clipboard */
+   char *saved_clipboard;
 } Item_Desc;
 
 static void _start_stop_bt_clicked(void *data, Evas_Object *obj, void *event_info);
+static void _sched_run_done(Item_Desc *idesc);
+static Eo *_cnp_obj_get(Instance *inst);
+static char *_file_get_as_string(const char *filename);
 
 static Eina_Bool
-_configure_dev(Instance *inst)
+_configure_dev(Device *dev)
 {
    struct uinput_user_dev uidev;
-   char *str = alloca(100);
    int ret;
    unsigned int i;
+   Eina_Bool rel_set = EINA_FALSE;
    memset(&uidev, 0, sizeof(uidev));
 
-   inst->fd = open("/dev/uinput", O_WRONLY);
-   check_ret(inst->fd);
+   dev->fd = open("/dev/uinput", O_WRONLY);
+   check_ret(dev->fd);
 
-   snprintf(uidev.name, UINPUT_MAX_NAME_SIZE, "uinput-sample");
+   snprintf(uidev.name, UINPUT_MAX_NAME_SIZE, "%s", dev->name);
+   uidev.id = dev->id;
 
-   uidev.id.bustype = BUS_USB;
-   uidev.id.vendor  = 1;
-   uidev.id.product = 1;
-   uidev.id.version = 1;
-
-   ret = write(inst->fd, &uidev, sizeof(uidev));
+   ret = write(dev->fd, &uidev, sizeof(uidev));
    if (ret != sizeof(uidev)) {
         PRINT("Failed to write dev structure");
         return EINA_FALSE;
    }
 
-   ret = ioctl(inst->fd, UI_SET_EVBIT, EV_KEY);
+   ret = ioctl(dev->fd, UI_SET_EVBIT, EV_KEY);
    check_ret(ret);
 
-   inst->keys_map = eina_hash_string_superfast_new(NULL);
-   for(i = 0; i < sizeof(kmap) / sizeof(*kmap); i++) {
-        memcpy(str, kmap[i].string, strlen(kmap[i].string) + 1);
-        eina_str_tolower(&str);
-        eina_hash_set(inst->keys_map, str, &(kmap[i]));
-        ret = ioctl(inst->fd, UI_SET_KEYBIT, kmap[i].kernelcode);
+   for(i = 0; i < KEY_CNT; i++) {
+        if (!BIT_TEST(dev->keys, i)) continue;
+        ret = ioctl(dev->fd, UI_SET_KEYBIT, i);
+        check_ret(ret);
+   }
+
+   for(i = 0; i < REL_CNT; i++) {
+        if (!BIT_TEST(dev->rels, i)) continue;
+        if (!rel_set) {
+             ret = ioctl(dev->fd, UI_SET_EVBIT, EV_REL);
+             check_ret(ret);
+             rel_set = EINA_TRUE;
+        }
+        ret = ioctl(dev->fd, UI_SET_RELBIT, i);
         check_ret(ret);
    }
 
-   ret = ioctl(inst->fd, UI_DEV_CREATE);
+   if (dev->rep_delay) {
+        ret = ioctl(dev->fd, UI_SET_EVBIT, EV_REP);
+        check_ret(ret);
+   }
+
+   ret = ioctl(dev->fd, UI_DEV_CREATE);
+   check_ret(ret);
+   PRINT("Init of %s done", dev->profile);
+   return EINA_TRUE;
+}
+
+static Eina_Bool
+_sim_event_write(Device *dev)
+{
+   int ret;
+   dev->ev.input_event_sec = dev->clock / 1000000;
+   dev->ev.input_event_usec = dev->clock % 1000000;
+   dev->sim_events++;
+   if (!dev->sim_text)
+      return fwrite(&dev->ev, sizeof(dev->ev), 1, dev->sim) == 1;
+   ret = fprintf(dev->sim, "%llu.%06llu %s %d %d\n",
+         dev->clock / 1000000, dev->clock % 1000000,
+         dev->ev.type == EV_KEY ? "EV_KEY" : dev->ev.type == EV_SYN ? "EV_SYN" : "EV_REP",
+         dev->ev.code, dev->ev.value);
    check_ret(ret);
-   PRINT("Init done");
    return EINA_TRUE;
 }
 
 static Eina_Bool
-_send_event(Instance *inst, __u16 type, __u16 code, __s32 value)
+_send_event(Device *dev, __u16 type, __u16 code, __s32 value)
 {
    int ret;
-   memset(&inst->ev, 0, sizeof(inst->ev));
+   memset(&dev->ev, 0, sizeof(dev->ev));
 
-   inst->ev.type = type;
-   inst->ev.code = code;
-   inst->ev.value = value;
+   dev->ev.type = type;
+   dev->ev.code = code;
+   dev->ev.value = value;
 
-   ret = write(inst->fd, &inst->ev, sizeof(inst->ev));
+   if (dev->sim) return _sim_event_write(dev);
+   ret = write(dev->fd, &dev->ev, sizeof(dev->ev));
    check_ret(ret);
    return EINA_TRUE;
 }
 
+/* Return the device of a profile, creating it if needed */
+static Device *
+_device_get(const char *profile)
+{
+   Device *dev = eina_hash_find(_devices, profile ? profile : DEFAULT_PROFILE);
+   if (!dev)
+     {
+        PRINT("Unknown device profile %s", profile);
+        return NULL;
+     }
+   if (dev->fd != -1) return dev;
+   if (!_configure_dev(dev))
+     {
+        PRINT("Failed to create the device %s\n"
+              "Did you add a rule in /etc/udev/rules.d/ to chmod 666 /dev/uinput?\n"
+              "Did you add uinput to the modules to load (/etc/modules-load.d/?", dev->profile);
+        if (dev->fd != -1) close(dev->fd);
+        dev->fd = -1;
+        return NULL;
+     }
+   /* Repeat settings can only be given once the device exists */
+   if (dev->rep_delay)
+     {
+        _send_event(dev, EV_REP, REP_DELAY, dev->rep_delay);
+        _send_event(dev, EV_REP, REP_PERIOD, dev->rep_period);
+     }
+   return dev;
+}
+
+static void
+_device_free(Device *dev)
+{
+   if (dev->fd != -1)
+     {
+        ioctl(dev->fd, UI_DEV_DESTROY);
+        close(dev->fd);
+     }
+   eina_stringshare_del(dev->profile);
+   free(dev);
+}
+
 static Eina_Bool _consume(void *data);
 
 static void
 _send_key(Item_Desc *idesc, int key, int state)
 {
-   _send_event(idesc->instance, EV_KEY, key, state);
-   _send_event(idesc->instance, EV_SYN, SYN_REPORT, 0);
+   _send_event(idesc->device, EV_KEY, key, state);
+   _send_event(idesc->device, EV_SYN, SYN_REPORT, 0);
 }
 
 static int
-_key_find_from_char(Instance *inst, char c)
+_key_find_from_char(char c)
 {
    char str[2];
    str[0] = tolower(c);
    str[1] = '\0';
-   struct map *key = eina_hash_find(inst->keys_map, str);
+   struct map *key = eina_hash_find(_keys_map, str);
    if (!key)
      {
         PRINT("Key not found for %c", c);
@@ -162,242 +410,1856 @@ _key_find_from_char(Instance *inst, char c)
 }
 
 static int
-_key_find_from_string(Instance *inst, const char *string, int len)
+_key_find_from_string(const char *string, int len)
 {
    char *str = alloca(len + 1);
    memcpy(str, string, len);
    str[len] = '\0';
    eina_str_tolower(&str);
-   struct map *key = eina_hash_find(inst->keys_map, str);
+   struct map *key = eina_hash_find(_keys_map, str);
    if (!key)
      {
-        PRINT("Key not found for %s", str);
-        return -1;
+        PRINT("Key not found for %s", str);
+        return -1;
+     }
+   return key->kernelcode;
+}
+
+static unsigned long long
+_now_us(void)
+{
+   struct timespec ts;
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return ts.tv_sec * 1000000ULL + ts.tv_nsec / 1000;
+}
+
+#define WSKIP(p) while (*(p) == ' ') (p)++
+
+static const struct map _buttons_map[] =
+{
+     { BTN_LEFT, "LEFT" },
+     { BTN_RIGHT, "RIGHT" },
+     { BTN_MIDDLE, "MIDDLE" },
+     { BTN_SIDE, "SIDE" },
+     { BTN_EXTRA, "EXTRA" },
+     { BTN_FORWARD, "FORWARD" },
+     { BTN_BACK, "BACK" },
+     { BTN_TOUCH, "TOUCH" }
+};
+
+static const struct map _axes_map[] =
+{
+     { REL_X, "X" },
+     { REL_Y, "Y" },
+     { REL_WHEEL, "WHEEL" },
+     { REL_HWHEEL, "HWHEEL" }
+};
+
+static const struct map _bus_map[] =
+{
+     { BUS_USB, "USB" },
+     { BUS_BLUETOOTH, "BLUETOOTH" },
+     { BUS_I8042, "I8042" },
+     { BUS_VIRTUAL, "VIRTUAL" }
+};
+
+static int
+_map_find(const struct map *m, unsigned int nb, const char *string)
+{
+   unsigned int i;
+   for (i = 0; i < nb; i++)
+      if (!strcasecmp(m[i].string, string)) return m[i].kernelcode;
+   return -1;
+}
+
+static Device *
+_device_new(const char *profile)
+{
+   unsigned int i;
+   Device *dev = calloc(1, sizeof(*dev));
+   dev->profile = eina_stringshare_add(profile);
+   dev->fd = -1;
+   snprintf(dev->name, sizeof(dev->name), "uinput-sample");
+   dev->id.bustype = BUS_USB;
+   dev->id.vendor = 1;
+   dev->id.product = 1;
+   dev->id.version = 1;
+   for (i = 0; i < sizeof(kmap) / sizeof(*kmap); i++) BIT_SET(dev->keys, kmap[i].kernelcode);
+   eina_hash_add(_devices, dev->profile, dev);
+   return dev;
+}
+
+/*
+ * Parse a "key = value" line of a profile section.
+ * keys, buttons and axes are lists separated by spaces, keys can be "all".
+ */
+static Eina_Bool
+_device_profile_set(Device *dev, char *key, char *value, Eina_Bool *keys_set)
+{
+   char *tok, *saveptr = NULL;
+   int code;
+
+   if (!strcmp(key, "name"))
+      snprintf(dev->name, sizeof(dev->name), "%s", value);
+   else if (!strcmp(key, "bus"))
+     {
+        code = _map_find(_bus_map, sizeof(_bus_map) / sizeof(*_bus_map), value);
+        dev->id.bustype = code != -1 ? code : strtol(value, NULL, 0);
+     }
+   else if (!strcmp(key, "vendor")) dev->id.vendor = strtol(value, NULL, 0);
+   else if (!strcmp(key, "product")) dev->id.product = strtol(value, NULL, 0);
+   else if (!strcmp(key, "version")) dev->id.version = strtol(value, NULL, 0);
+   else if (!strcmp(key, "repeat"))
+     {
+        if (sscanf(value, "%d %d", &dev->rep_delay, &dev->rep_period) != 2) return EINA_FALSE;
+     }
+   else if (!strcmp(key, "keys") || !strcmp(key, "buttons") || !strcmp(key, "axes"))
+     {
+        /* The first keys line replaces the default set of all the keys */
+        if (*key == 'k' && !*keys_set)
+          {
+             /* The buttons are after the keys in the bitmap */
+             memset(dev->keys, 0, BTN_MISC / 8);
+             *keys_set = EINA_TRUE;
+          }
+        for (tok = strtok_r(value, " ", &saveptr); tok; tok = strtok_r(NULL, " ", &saveptr))
+          {
+             if (*key == 'k' && !strcasecmp(tok, "all"))
+               {
+                  unsigned int i;
+                  for (i = 0; i < sizeof(kmap) / sizeof(*kmap); i++) BIT_SET(dev->keys, kmap[i].kernelcode);
+                  continue;
+               }
+             if (*key == 'k') code = _key_find_from_string(tok, strlen(tok));
+             else if (*key == 'b') code = _map_find(_buttons_map, sizeof(_buttons_map) / sizeof(*_buttons_map), tok);
+             else code = _map_find(_axes_map, sizeof(_axes_map) / sizeof(*_axes_map), tok);
+             if (code == -1)
+               {
+                  PRINT("Unknown %s entry: %s", key, tok);
+                  return EINA_FALSE;
+               }
+             if (*key == 'a') BIT_SET(dev->rels, code);
+             else BIT_SET(dev->keys, code);
+          }
+     }
+   else
+     {
+        PRINT("Unknown device setting: %s", key);
+        return EINA_FALSE;
+     }
+   return EINA_TRUE;
+}
+
+/*
+ * Load the device profiles of a file, if any. The "default" profile
+ * always exists and keeps the historical identity with all the keys.
+ */
+static Eina_Bool
+_device_profiles_load(const char *path)
+{
+   char *filedata, *line, *next;
+   unsigned int line_nb = 0;
+   Eina_Bool keys_set = EINA_FALSE;
+   Device *dev = _device_new(DEFAULT_PROFILE);
+
+   if (!path || !ecore_file_exists(path)) return EINA_TRUE;
+   filedata = _file_get_as_string(path);
+   if (!filedata) return EINA_FALSE;
+
+   for (line = filedata; line; line = next)
+     {
+        char *p = line, *end, *eq;
+
+        next = strchr(line, '\n');
+        if (next) *next++ = '\0';
+        line_nb++;
+
+        while (isspace(*p)) p++;
+        end = p + strlen(p);
+        while (end > p && isspace(end[-1])) *--end = '\0';
+        if (!*p || *p == '#') continue;
+
+        if (*p == '[')
+          {
+             if (end[-1] != ']') goto error;
+             end[-1] = '\0';
+             p++;
+             dev = eina_hash_find(_devices, p);
+             if (!dev) dev = _device_new(p);
+             keys_set = EINA_FALSE;
+             continue;
+          }
+        eq = strchr(p, '=');
+        if (!eq) goto error;
+        end = eq;
+        while (end > p && isspace(end[-1])) end--;
+        *end = '\0';
+        eq++;
+        while (isspace(*eq)) eq++;
+        if (!_device_profile_set(dev, p, eq, &keys_set)) goto error;
+     }
+   free(filedata);
+   return EINA_TRUE;
+
+error:
+   PRINT("Error in %s at line %d", path, line_nb);
+   free(filedata);
+   return EINA_FALSE;
+}
+
+
+/*
+ * Parse a cron field: "*", "n", "a-b", with an optional "/step",
+ * separated by commas.
+ */
+static Eina_Bool
+_cron_field_parse(const char *str, int min, int max, unsigned long long *bits)
+{
+   *bits = 0;
+   while (*str)
+     {
+        char *end;
+        int from = min, to = max, step = 1, i;
+        if (*str == '*') end = (char *)str + 1;
+        else
+          {
+             from = to = strtol(str, &end, 10);
+             if (end == str) return EINA_FALSE;
+             if (*end == '-')
+               {
+                  str = end + 1;
+                  to = strtol(str, &end, 10);
+                  if (end == str) return EINA_FALSE;
+               }
+          }
+        if (*end == '/')
+          {
+             str = end + 1;
+             step = strtol(str, &end, 10);
+             if (end == str || step <= 0) return EINA_FALSE;
+             if (from == to) to = max;
+          }
+        if (from < min || to > max || from > to) return EINA_FALSE;
+        for (i = from; i <= to; i += step) *bits |= 1ULL << i;
+        if (*end == ',') end++;
+        else if (*end) return EINA_FALSE;
+        str = end;
+     }
+   return *bits != 0;
+}
+
+static Eina_Bool
+_schedule_parse(Schedule *sched, char *p)
+{
+   if (!strncmp(p, "EVERY ", 6))
+     {
+        char *end = NULL;
+        long interval = strtol(p + 6, &end, 10);
+        WSKIP(end);
+        if (*end || interval <= 0) return EINA_FALSE;
+        sched->type = SCHED_EVERY;
+        sched->interval = interval;
+        return EINA_TRUE;
+     }
+   if (!strncmp(p, "CRON ", 5))
+     {
+        char *fields[5], *saveptr = NULL;
+        unsigned long long bits[5];
+        static const int mins[5] = { 0, 0, 1, 1, 0 }, maxs[5] = { 59, 23, 31, 12, 7 };
+        int i;
+        for (i = 0; i < 5; i++)
+          {
+             fields[i] = strtok_r(i ? NULL : p + 5, " ", &saveptr);
+             if (!fields[i] || !_cron_field_parse(fields[i], mins[i], maxs[i], &bits[i]))
+                return EINA_FALSE;
+          }
+        if (strtok_r(NULL, " ", &saveptr)) return EINA_FALSE;
+        sched->type = SCHED_CRON;
+        sched->minutes = bits[0];
+        sched->hours = bits[1];
+        sched->mdays = bits[2];
+        sched->months = bits[3];
+        /* 7 is Sunday too */
+        sched->wdays = (bits[4] | (bits[4] >> 7)) & 0x7F;
+        sched->mdays_any = *fields[2] == '*';
+        sched->wdays_any = *fields[4] == '*';
+        return EINA_TRUE;
+     }
+   return EINA_FALSE;
+}
+
+static void
+_script_op_add(Script *script, Op_Type type, int key, unsigned long long delay)
+{
+   Script_Op op;
+   op.type = type;
+   op.key = key;
+   op.delay = delay;
+   op.offset = script->duration;
+   op.text = NULL;
+   op.count = 1;
+   op.stride = 0;
+   eina_inarray_push(script->ops, &op);
+   script->duration += delay;
+}
+
+static void
+_script_strided_add(Script *script, Op_Type type, int key,
+      unsigned int count, unsigned int stride, unsigned long long delay)
+{
+   Script_Op *op;
+   _script_op_add(script, type, key, delay);
+   op = eina_inarray_nth(script->ops, eina_inarray_count(script->ops) - 1);
+   op->count = count;
+   op->stride = stride;
+}
+
+static void
+_script_paste_add(Script *script, const char *text)
+{
+   Script_Op *op;
+   _script_op_add(script, OP_PASTE, 0, PASTE_DELAY);
+   op = eina_inarray_nth(script->ops, eina_inarray_count(script->ops) - 1);
+   op->text = eina_stringshare_add(text);
+}
+
+/*
+ * Append the key events of a recording (raw input_event records, as read
+ * from /dev/input/eventX) keeping the intervals given by their timestamps.
+ * Autorepeats (value 2) are dropped, the receiver generates its own.
+ * A relative path is taken from the directory of the script.
+ */
+static Eina_Bool
+_script_recording_add(Script *script, const char *seq, const char *filename)
+{
+   struct input_event ev;
+   struct stat st;
+   unsigned long long t, last = 0;
+   Script_Recording *rec;
+   const char *slash = strrchr(seq, '/');
+   char path[1024];
+   FILE *fp;
+
+   if (*filename != '/' && slash)
+      snprintf(path, sizeof(path), "%.*s/%s", (int)(slash - seq), seq, filename);
+   else snprintf(path, sizeof(path), "%s", filename);
+   fp = fopen(path, "rb");
+   if (!fp || fstat(fileno(fp), &st))
+     {
+        PRINT("Can not open recording: \"%s\".", path);
+        if (fp) fclose(fp);
+        return EINA_FALSE;
+     }
+   rec = calloc(1, sizeof(*rec));
+   rec->filename = eina_stringshare_add(path);
+   rec->ino = st.st_ino;
+   rec->mtime = st.st_mtime;
+   rec->size = st.st_size;
+   script->recordings = eina_list_append(script->recordings, rec);
+   while (fread(&ev, sizeof(ev), 1, fp) == 1)
+     {
+        if (ev.type != EV_KEY || ev.value == 2) continue;
+        if (ev.code >= KEY_CNT)
+          {
+             PRINT("Key %d of the recording is invalid", ev.code);
+             fclose(fp);
+             return EINA_FALSE;
+          }
+        t = ev.input_event_sec * 1000000ULL + ev.input_event_usec;
+        if (last && t > last) _script_op_add(script, OP_DELAY, 0, t - last);
+        last = t;
+        _script_op_add(script, ev.value ? OP_KEY_DOWN : OP_KEY_UP, ev.code, 0);
+     }
+   fclose(fp);
+   return EINA_TRUE;
+}
+
+static void
+_script_free(Script *script)
+{
+   Script_Recording *rec;
+   unsigned int i;
+   if (!script) return;
+   eina_stringshare_del(script->filename);
+   eina_stringshare_del(script->device);
+   EINA_LIST_FREE(script->recordings, rec)
+     {
+        eina_stringshare_del(rec->filename);
+        free(rec);
+     }
+   for (i = 0; i < eina_inarray_count(script->ops); i++)
+     {
+        Script_Op *op = eina_inarray_nth(script->ops, i);
+        eina_stringshare_del(op->text);
+     }
+   eina_inarray_free(script->ops);
+   free(script);
+}
+
+static void
+_script_unref(Script *script)
+{
+   if (script && !--script->refs) _script_free(script);
+}
+
+static Script *_script_compile(const char *filename);
+
+/*
+ * Drop the cache entry of a file, the players keep their own references.
+ * The reference of the cache is released by the free callback of the hash.
+ */
+static void
+_script_uncache(const char *filename)
+{
+   eina_hash_del_by_key(_scripts, filename);
+}
+
+/* Return the cached script of a file if it is up to date with st */
+static Script *
+_script_cached_get(const char *filename, const struct stat *st)
+{
+   Script *script = eina_hash_find(_scripts, filename);
+   Script_Recording *rec;
+   Eina_List *itr;
+   struct stat rst;
+
+   if (script && (script->ino != st->st_ino ||
+            script->mtime != st->st_mtime || script->size != st->st_size))
+     {
+        _script_uncache(filename);
+        return NULL;
+     }
+   EINA_LIST_FOREACH(script ? script->recordings : NULL, itr, rec)
+     {
+        if (!stat(rec->filename, &rst) && rst.st_ino == rec->ino &&
+              rst.st_mtime == rec->mtime && rst.st_size == rec->size) continue;
+        _script_uncache(filename);
+        return NULL;
+     }
+   return script;
+}
+
+static void
+_script_cache_add(const char *filename, const struct stat *st, Script *script)
+{
+   _script_uncache(filename);
+   script->filename = eina_stringshare_add(filename);
+   script->ino = st->st_ino;
+   script->mtime = st->st_mtime;
+   script->size = st->st_size;
+   script->refs = 1;
+   eina_hash_add(_scripts, script->filename, script);
+}
+
+/*
+ * Return a reference on the compiled script of a file.
+ * The cache entry is reused as long as the inode, the mtime and the size
+ * of the file are unchanged, so a Play only costs a stat.
+ */
+static Script *
+_script_get(const char *filename)
+{
+   struct stat st;
+   Script *script;
+
+   if (stat(filename, &st))
+     {
+        PRINT("Can not stat file: \"%s\".", filename);
+        _script_uncache(filename);
+        return NULL;
+     }
+   script = _script_cached_get(filename, &st);
+   if (!script)
+     {
+        script = _script_compile(filename);
+        if (!script) return NULL;
+        _script_cache_add(filename, &st, script);
+     }
+   script->refs++;
+   return script;
+}
+
+/*
+ * Translate the text of a script into a flat list of ops.
+ * Each op knows its delay and its offset from the beginning, so the
+ * total duration and the progress are known without replaying anything.
+ */
+static Script *
+_script_compile(const char *filename)
+{
+   char *filedata = _file_get_as_string(filename);
+   char *line, *next;
+   unsigned int line_nb = 0, pacing = DELAY, paste_threshold = 0, i;
+   Script *script;
+   Device *dev;
+
+   if (!filedata) return NULL;
+
+   script = calloc(1, sizeof(*script));
+   script->ops = eina_inarray_new(sizeof(Script_Op), 32);
+   script->sched.max_concurrent = 1;
+   script->chord[0] = KEY_LEFTCTRL;
+   script->chord[1] = KEY_V;
+   script->chord_nb = 2;
+
+   for (line = filedata; line; line = next)
+     {
+        char *p = line;
+        Op_Type type = OP_KEY;
+        int len = 0;
+
+        next = strchr(line, '\n');
+        if (next) *next++ = '\0';
+        line_nb++;
+
+        WSKIP(p);
+        if (!*p) continue;
+
+        if (!strncmp(p, "KEY ", 4)) { type = OP_KEY; len = 3; }
+        else if (!strncmp(p, "KEY_DOWN ", 9)) { type = OP_KEY_DOWN; len = 8; }
+        else if (!strncmp(p, "KEY_UP ", 7)) { type = OP_KEY_UP; len = 6; }
+
+        if (len)
+          {
+             p += len;
+             WSKIP(p);
+             while (*p)
+               {
+                  char *end = p;
+                  while (*end && *end != ' ') end++;
+                  int key = _key_find_from_string(p, end - p);
+                  if (key == -1) goto error;
+                  _script_op_add(script, type, key, pacing);
+                  p = end;
+                  WSKIP(p);
+               }
+          }
+        else if (!strncmp(p, "TYPE ", 5) && paste_threshold &&
+              strlen(p + 5) > paste_threshold)
+          {
+             _script_paste_add(script, p + 5);
+          }
+        else if (!strncmp(p, "TYPE ", 5))
+          {
+             for (p += 5; *p; p++)
+               {
+                  int key = _key_find_from_char(*p);
+                  if (key == -1) goto error;
+                  _script_op_add(script, OP_KEY, key, pacing);
+               }
+          }
+        else if (!strncmp(p, "DELAY ", 6))
+          {
+             char *end = NULL;
+             long long d;
+             errno = 0;
+             d = strtoll(p + 6, &end, 10);
+             WSKIP(end);
+             if (*end || d < 0 || errno == ERANGE || d > LLONG_MAX / 1000)
+               {
+                  PRINT("DELAY expects an integer representing milliseconds");
+                  goto error;
+               }
+             _script_op_add(script, OP_DELAY, 0, d * 1000);
+          }
+        else if (!strncmp(p, "DELAY_US ", 9))
+          {
+             char *end = NULL;
+             long long d;
+             errno = 0;
+             d = strtoll(p + 9, &end, 10);
+             WSKIP(end);
+             if (*end || d < 0 || errno == ERANGE)
+               {
+                  PRINT("DELAY_US expects an integer representing microseconds");
+                  goto error;
+               }
+             _script_op_add(script, OP_DELAY, 0, d);
+          }
+        else if (!strncmp(p, "TIMING ", 7))
+          {
+             char *end = NULL;
+             p += 7;
+             WSKIP(p);
+             if (!strncmp(p, "PRECISE", 7))
+               {
+                  script->precise = EINA_TRUE;
+                  script->adaptive = EINA_FALSE;
+                  script->spin = SPIN_DEFAULT;
+                  pacing = 0;
+                  p += 7;
+                  WSKIP(p);
+                  if (*p)
+                    {
+                       long spin = strtol(p, &end, 10);
+                       WSKIP(end);
+                       script->spin = spin;
+                       if (spin < 0 || spin > SPIN_MAX) end = p;
+                    }
+                  if (end && *end)
+                    {
+                       PRINT("TIMING PRECISE expects an optional busy-wait of at most %dus",
+                             SPIN_MAX);
+                       goto error;
+                    }
+               }
+             else
+               {
+                  PRINT("Unknown timing mode: %s", p);
+                  goto error;
+               }
+          }
+        else if (!strncmp(p, "PACING ", 7))
+          {
+             char *end = NULL;
+             long min = -1, max = -1;
+             p += 7;
+             WSKIP(p);
+             if (!strncmp(p, "FIXED ", 6))
+               {
+                  min = max = strtol(p + 6, &end, 10);
+               }
+             else if (!strncmp(p, "ADAPTIVE ", 9))
+               {
+                  min = strtol(p + 9, &end, 10);
+                  max = strtol(end, &end, 10);
+               }
+             if (end) WSKIP(end);
+             /* The gap is doubled on backoff, it has to stay in range */
+             if (!end || *end || min < 0 || max < min || max > UINT_MAX / 2000)
+               {
+                  PRINT("PACING expects FIXED <ms> or ADAPTIVE <min_ms> <max_ms>");
+                  goto error;
+               }
+             script->adaptive = min != max;
+             script->pace_min = min * 1000;
+             script->pace_max = max * 1000;
+             script->precise = EINA_FALSE;
+             pacing = script->pace_min;
+          }
+        else if (!strncmp(p, "HOLD ", 5) || !strncmp(p, "REPEAT_KEY ", 11))
+          {
+             Eina_Bool hold = *p == 'H';
+             char *end;
+             long long n1, n2 = 1;
+             int key;
+             p += hold ? 5 : 11;
+             WSKIP(p);
+             end = p;
+             while (*end && *end != ' ') end++;
+             key = _key_find_from_string(p, end - p);
+             if (key == -1) goto error;
+             n1 = strtoll(end, &end, 10);
+             if (!hold) n2 = strtoll(end, &end, 10);
+             WSKIP(end);
+             /* The stride and the count have to fit their fields */
+             if (*end || n1 <= 0 || n2 <= 0 || n2 > 1000000 ||
+                   n1 > (hold ? UINT_MAX / 1000 : UINT_MAX))
+               {
+                  PRINT("%s", hold ? "HOLD expects a key and a duration in milliseconds" :
+                        "REPEAT_KEY expects a key, a count and a rate in Hz");
+                  goto error;
+               }
+             /* The hold is followed by the pacing, the repeats by their period */
+             if (hold) _script_strided_add(script, OP_HOLD, key, 2, n1 * 1000, n1 * 1000ULL + pacing);
+             else _script_strided_add(script, OP_REPEAT, key, n1, 1000000 / n2, n1 * (1000000ULL / n2));
+          }
+        else if (!strncmp(p, "PASTE ", 6))
+          {
+             _script_paste_add(script, p + 6);
+          }
+        else if (!strncmp(p, "PASTE_THRESHOLD ", 16))
+          {
+             char *end = NULL;
+             long n = strtol(p + 16, &end, 10);
+             WSKIP(end);
+             if (*end || n < 0)
+               {
+                  PRINT("PASTE_THRESHOLD expects a number of characters");
+                  goto error;
+               }
+             paste_threshold = n;
+          }
+        else if (!strncmp(p, "PASTE_CHORD ", 12))
+          {
+             p += 12;
+             WSKIP(p);
+             script->chord_nb = 0;
+             while (*p)
+               {
+                  char *end = p;
+                  while (*end && *end != ' ') end++;
+                  int key = _key_find_from_string(p, end - p);
+                  if (key == -1) goto error;
+                  if (script->chord_nb == PASTE_CHORD_MAX)
+                    {
+                       PRINT("PASTE_CHORD supports up to %d keys", PASTE_CHORD_MAX);
+                       goto error;
+                    }
+                  script->chord[script->chord_nb++] = key;
+                  p = end;
+                  WSKIP(p);
+               }
+          }
+        else if (!strncmp(p, "SCHEDULE ", 9))
+          {
+             p += 9;
+             WSKIP(p);
+             if (!_schedule_parse(&script->sched, p))
+               {
+                  PRINT("SCHEDULE expects EVERY <seconds> or CRON <min> <hour> <mday> <month> <wday>");
+                  goto error;
+               }
+          }
+        else if (!strncmp(p, "JITTER ", 7) || !strncmp(p, "MAX_CONCURRENT ", 15))
+          {
+             char *end = NULL;
+             Eina_Bool jitter = *p == 'J';
+             long n = strtol(p + (jitter ? 7 : 15), &end, 10);
+             WSKIP(end);
+             if (*end || n < !jitter)
+               {
+                  PRINT("%s expects a positive integer", jitter ? "JITTER" : "MAX_CONCURRENT");
+                  goto error;
+               }
+             if (jitter) script->sched.jitter = n;
+             else script->sched.max_concurrent = n;
+          }
+        else if (!strncmp(p, "ON_MISSED ", 10) || !strncmp(p, "ON_OVERLAP ", 11))
+          {
+             Eina_Bool missed = p[3] == 'M';
+             p += missed ? 10 : 11;
+             WSKIP(p);
+             if (!strcmp(p, "SKIP") || !strcmp(p, missed ? "RUN" : "QUEUE"))
+               {
+                  if (missed) script->sched.run_missed = *p == 'R';
+                  else script->sched.queue_overlap = *p == 'Q';
+               }
+             else
+               {
+                  PRINT("%s expects SKIP or %s", missed ? "ON_MISSED" : "ON_OVERLAP",
+                        missed ? "RUN" : "QUEUE");
+                  goto error;
+               }
+          }
+        else if (!strncmp(p, "DEVICE ", 7))
+          {
+             p += 7;
+             WSKIP(p);
+             if (!eina_hash_find(_devices, p))
+               {
+                  PRINT("Unknown device profile %s", p);
+                  goto error;
+               }
+             eina_stringshare_replace(&script->device, p);
+          }
+        else if (!strncmp(p, "RECORDING ", 10))
+          {
+             p += 10;
+             WSKIP(p);
+             if (!_script_recording_add(script, filename, p)) goto error;
+          }
+        else
+          {
+             PRINT("Unknown token: %s", p);
+             goto error;
+          }
+     }
+   free(filedata);
+
+   /* Only the keys advertised by the device can be played */
+   dev = eina_hash_find(_devices, script->device ? script->device : DEFAULT_PROFILE);
+   for (i = 0; i < eina_inarray_count(script->ops); i++)
+     {
+        Script_Op *op = eina_inarray_nth(script->ops, i);
+        unsigned int j;
+        if (op->type != OP_DELAY && op->type != OP_PASTE && !BIT_TEST(dev->keys, op->key))
+          {
+             PRINT("Key %d is not supported by the device %s of %s", op->key, dev->profile, filename);
+             _script_free(script);
+             return NULL;
+          }
+        for (j = 0; op->type == OP_PASTE && j < script->chord_nb; j++)
+          {
+             if (BIT_TEST(dev->keys, script->chord[j])) continue;
+             PRINT("Paste key %d is not supported by the device %s of %s",
+                   script->chord[j], dev->profile, filename);
+             _script_free(script);
+             return NULL;
+          }
+     }
+   PRINT("%s compiled: %d ops, %lluus", filename,
+         eina_inarray_count(script->ops), script->duration);
+   return script;
+
+error:
+   PRINT("Compilation of %s failed at line %d", filename, line_nb);
+   free(filedata);
+   _script_free(script);
+   return NULL;
+}
+
+static void
+_op_exec(Item_Desc *idesc, Script_Op *op, unsigned int step)
+{
+   switch (op->type)
+     {
+      case OP_KEY:
+      case OP_REPEAT:
+         _send_key(idesc, op->key, 1);
+         _send_key(idesc, op->key, 0);
+         break;
+      case OP_HOLD:
+         _send_key(idesc, op->key, step ? 0 : 1);
+         break;
+      case OP_KEY_DOWN:
+         _send_key(idesc, op->key, 1);
+         BIT_SET(idesc->keys_down, op->key);
+         break;
+      case OP_KEY_UP:
+         _send_key(idesc, op->key, 0);
+         BIT_CLEAR(idesc->keys_down, op->key);
+         break;
+      case OP_DELAY:
+         break;
+      case OP_PASTE:
+        {
+           Script *script = idesc->script;
+           Eo *obj = _cnp_obj_get(idesc->instance);
+           int i;
+           /* Without a clipboard, the chord would paste whatever is in it.
+            * The simulation has no clipboard but still records the chord. */
+           if (obj) elm_cnp_selection_set(obj, ELM_SEL_TYPE_CLIPBOARD,
+                 ELM_SEL_FORMAT_TEXT, op->text, strlen(op->text));
+           else if (!idesc->device->sim)
+             {
+                PRINT("No clipboard available, paste of %s skipped", idesc->filename);
+                break;
+             }
+           for (i = 0; i < (int)script->chord_nb; i++) _send_key(idesc, script->chord[i], 1);
+           for (i = script->chord_nb - 1; i >= 0; i--) _send_key(idesc, script->chord[i], 0);
+           break;
+        }
+     }
+}
+
+static void
+_op_print(Script_Op *op)
+{
+   switch (op->type)
+     {
+      case OP_KEY:
+         PRINT("Key %d", op->key);
+         break;
+      case OP_KEY_DOWN:
+      case OP_KEY_UP:
+         PRINT("Key %d %s", op->key, op->type == OP_KEY_DOWN ? "Down" : "Up");
+         break;
+      case OP_DELAY:
+         PRINT("Delay %lluus", op->delay);
+         break;
+      case OP_PASTE:
+         PRINT("Paste %d chars", (int)strlen(op->text));
+         break;
+      case OP_HOLD:
+         PRINT("Hold %d for %uus", op->key, op->stride);
+         break;
+      case OP_REPEAT:
+         PRINT("Repeat %d %u times every %uus", op->key, op->count, op->stride);
+         break;
+     }
+}
+
+static void _paste_begin(Item_Desc *idesc, Script_Op *op);
+
+/*
+ * Precise mode: every op has an absolute deadline (start + offset).
+ * The timer is armed to wake up a bit before it and the remaining
+ * microseconds are busy-waited, so the error doesn't accumulate.
+ */
+static Eina_Bool
+_consume_precise(Item_Desc *idesc)
+{
+   Script *script = idesc->script;
+   while (idesc->cur_op < eina_inarray_count(script->ops))
+     {
+        Script_Op *op = eina_inarray_nth(script->ops, idesc->cur_op);
+        unsigned long long deadline = idesc->start_time + op->offset +
+           (unsigned long long)idesc->cur_step * op->stride;
+        unsigned long long now = _now_us();
+        if (deadline > now + script->spin)
+          {
+             idesc->timer = ecore_timer_add((deadline - now - script->spin) / 1000000.0,
+                   _consume, idesc);
+             return EINA_FALSE;
+          }
+        while (now < deadline) now = _now_us();
+        if (op->type == OP_PASTE)
+          {
+             /* The clipboard is saved and restored, the next ops may be late */
+             idesc->cur_op++;
+             _paste_begin(idesc, op);
+             return EINA_FALSE;
+          }
+        _op_exec(idesc, op, idesc->cur_step);
+        if (now - deadline > idesc->late_max) idesc->late_max = now - deadline;
+        idesc->late_sum += now - deadline;
+        idesc->late_nb++;
+        if (++idesc->cur_step == op->count)
+          {
+             idesc->cur_step = 0;
+             idesc->cur_op++;
+          }
+     }
+   PRINT("Timing error: average %lluus, max %uus",
+         idesc->late_nb ? idesc->late_sum / idesc->late_nb : 0, idesc->late_max);
+   return EINA_TRUE;
+}
+
+static Eina_Bool _rect_intersects_focus(const Eina_Rectangle *r);
+
+/*
+ * Adaptive pacing, in the way of a congestion control: a key is acked
+ * when the target repaints after it. Each timely ack shrinks the gap by
+ * PACE_STEP, a missing ack doubles it and holds the next op until the
+ * ack comes or pace_max is elapsed.
+ */
+static void
+_feedback_render_post_cb(void *data, Evas *e EINA_UNUSED, void *event_info)
+{
+   Item_Desc *idesc = data;
+   Evas_Event_Render_Post *ev = event_info;
+   Eina_Rectangle *r;
+   Eina_List *itr;
+   Eina_Bool hit = EINA_FALSE;
+
+   if (!idesc->ack_pending) return;
+   EINA_LIST_FOREACH(ev ? ev->updated_area : NULL, itr, r)
+      if (_rect_intersects_focus(r)) hit = EINA_TRUE;
+   if (!hit) return;
+
+   idesc->ack_pending = EINA_FALSE;
+   if (idesc->stalled)
+     {
+        idesc->stalled = EINA_FALSE;
+        ecore_timer_del(idesc->timer);
+        idesc->timer = ecore_timer_add(0.0, _consume, idesc);
+     }
+   else if (_now_us() - idesc->sent_time <= idesc->gap)
+     {
+        Script *script = idesc->script;
+        idesc->gap = idesc->gap > script->pace_min + PACE_STEP ?
+           idesc->gap - PACE_STEP : script->pace_min;
+     }
+}
+
+/* Returns EINA_TRUE if the next op has to wait for the ack of the last key */
+static Eina_Bool
+_pace_hold(Item_Desc *idesc)
+{
+   Script *script = idesc->script;
+   unsigned long long waited;
+   unsigned int gap;
+
+   if (!idesc->ack_pending) return EINA_FALSE;
+   waited = _now_us() - idesc->sent_time;
+   if (!idesc->stalled)
+     {
+        idesc->stalled = EINA_TRUE;
+        idesc->timeouts++;
+        /* A null gap would never grow */
+        gap = idesc->gap < PACE_STEP ? PACE_STEP : idesc->gap * 2;
+        idesc->gap = gap < script->pace_max ? gap : script->pace_max;
+     }
+   if (waited < script->pace_max)
+     {
+        idesc->timer = ecore_timer_add((script->pace_max - waited) / 1000000.0, _consume, idesc);
+        return EINA_TRUE;
+     }
+   /* No ack at all, the key probably doesn't repaint anything */
+   idesc->ack_pending = EINA_FALSE;
+   idesc->stalled = EINA_FALSE;
+   return EINA_FALSE;
+}
+
+/*
+ * A paste replaces the clipboard for the time of the op: its content is
+ * saved first, the text is pasted and the saved content is put back
+ * once the op delay is elapsed. Only text content can be restored.
+ */
+static Eina_Bool
+_paste_restore(void *data)
+{
+   Item_Desc *idesc = data;
+   Eo *obj = _cnp_obj_get(idesc->instance);
+   idesc->timer = NULL;
+   if (obj && idesc->saved_clipboard)
+      elm_cnp_selection_set(obj, ELM_SEL_TYPE_CLIPBOARD, ELM_SEL_FORMAT_TEXT,
+            idesc->saved_clipboard, strlen(idesc->saved_clipboard));
+   free(idesc->saved_clipboard);
+   idesc->saved_clipboard = NULL;
+   return _consume(idesc);
+}
+
+static Eina_Bool
+_paste_do(void *data)
+{
+   Item_Desc *idesc = data;
+   Script_Op *op = idesc->paste_op;
+   idesc->timer = NULL;
+   idesc->paste_op = NULL;
+   _paste_waits = eina_list_remove(_paste_waits, idesc);
+   _op_exec(idesc, op, 0);
+   _op_print(op);
+   idesc->timer = ecore_timer_add(op->delay / 1000000.0, _paste_restore, idesc);
+   return EINA_FALSE;
+}
+
+/*
+ * The reply may come after the timeout, once the item is freed or is
+ * doing another paste: it is only accepted if its serial is still awaited.
+ */
+static Eina_Bool
+_paste_saved_cb(void *data, Evas_Object *obj EINA_UNUSED, Elm_Selection_Data *ev)
+{
+   unsigned int serial = (uintptr_t)data;
+   Item_Desc *idesc = NULL, *idesc2;
+   Eina_List *itr;
+   EINA_LIST_FOREACH(_paste_waits, itr, idesc2)
+      if (idesc2->paste_serial == serial) idesc = idesc2;
+   if (!idesc) return EINA_TRUE;
+   if ((ev->format & ELM_SEL_FORMAT_TEXT) && ev->data)
+      idesc->saved_clipboard = strndup(ev->data, ev->len);
+   ecore_timer_del(idesc->timer);
+   _paste_do(idesc);
+   return EINA_TRUE;
+}
+
+static void
+_paste_begin(Item_Desc *idesc, Script_Op *op)
+{
+   Eo *obj = _cnp_obj_get(idesc->instance);
+   idesc->paste_op = op;
+   idesc->paste_serial = ++_paste_serial;
+   _paste_waits = eina_list_append(_paste_waits, idesc);
+   idesc->timer = ecore_timer_add(obj ? PASTE_SAVE_TIMEOUT : 0.0, _paste_do, idesc);
+   if (obj) elm_cnp_selection_get(obj, ELM_SEL_TYPE_CLIPBOARD, ELM_SEL_FORMAT_TEXT,
+         _paste_saved_cb, (void *)(uintptr_t)idesc->paste_serial);
+}
+
+/*
+ * The steps of a strided op are run by a single timer ticking at the
+ * stride, there is no timer allocation per step.
+ */
+static Eina_Bool
+_strided_tick(void *data)
+{
+   Item_Desc *idesc = data;
+   Script_Op *op = eina_inarray_nth(idesc->script->ops, idesc->cur_op);
+   _op_exec(idesc, op, idesc->cur_step);
+   if (++idesc->cur_step < op->count)
+     {
+        /* First step, called from _consume */
+        if (idesc->cur_step == 1)
+           idesc->timer = ecore_timer_add(op->stride / 1000000.0, _strided_tick, idesc);
+        return EINA_TRUE;
+     }
+   idesc->cur_step = 0;
+   idesc->cur_op++;
+   idesc->timer = ecore_timer_add((op->delay - (unsigned long long)(op->count - 1) * op->stride) / 1000000.0,
+         _consume, idesc);
+   return EINA_FALSE;
+}
+
+static Eina_Bool
+_consume(void *data)
+{
+   Item_Desc *idesc = data;
+   Script *script = idesc->script;
+   idesc->timer = NULL;
+   if (script->precise)
+     {
+        if (!_consume_precise(idesc)) return EINA_FALSE;
+     }
+   else if (script->adaptive && _pace_hold(idesc)) return EINA_FALSE;
+   else if (idesc->cur_op < eina_inarray_count(script->ops))
+     {
+        Script_Op *op = eina_inarray_nth(script->ops, idesc->cur_op);
+        unsigned long long delay = op->delay;
+        if (op->count > 1)
+          {
+             _op_print(op);
+             idesc->cur_step = 0;
+             _strided_tick(idesc);
+             return EINA_FALSE;
+          }
+        idesc->cur_op++;
+        if (op->type == OP_PASTE)
+          {
+             _paste_begin(idesc, op);
+             return EINA_FALSE;
+          }
+        _op_exec(idesc, op, 0);
+        _op_print(op);
+        if (script->adaptive && op->type != OP_DELAY)
+          {
+             delay = idesc->gap;
+             /* Only full key strokes are expected to repaint the target */
+             if (op->type == OP_KEY && idesc->feedback_evas)
+               {
+                  idesc->ack_pending = EINA_TRUE;
+                  idesc->sent_time = _now_us();
+               }
+          }
+        idesc->timer = ecore_timer_add(delay / 1000000.0, _consume, idesc);
+        return EINA_FALSE;
+     }
+   if (script->adaptive)
+      PRINT("Adaptive pacing: final gap %uus, %u timeouts", idesc->gap, idesc->timeouts);
+   PRINT("Finishing consuming");
+   if (idesc->scheduled) _sched_run_done(idesc);
+   else _start_stop_bt_clicked(idesc, NULL, NULL);
+   return EINA_FALSE;
+}
+
+/*
+ * The position in the timeline is the offset of the next op minus what
+ * remains on the pending timer.
+ */
+static Eina_Bool
+_progress_update(void *data)
+{
+   Item_Desc *idesc = data;
+   Script *script = idesc->script;
+   unsigned long long done;
+   unsigned int eta;
+   char buf[64];
+
+   if (!idesc->progress) return EINA_TRUE;
+   if (!idesc->playing || !script || !script->duration)
+     {
+        elm_progressbar_value_set(idesc->progress, 0.0);
+        elm_object_text_set(idesc->progress, NULL);
+        return EINA_TRUE;
+     }
+
+   if (idesc->cur_op < eina_inarray_count(script->ops))
+     {
+        Script_Op *op = eina_inarray_nth(script->ops, idesc->cur_op);
+        done = op->offset + (unsigned long long)idesc->cur_step * op->stride;
+     }
+   else done = script->duration;
+   if (idesc->timer)
+     {
+        unsigned long long pending = ecore_timer_pending_get(idesc->timer) * 1000000;
+        done = pending < done ? done - pending : 0;
+     }
+
+   eta = (script->duration - done + 999999) / 1000000;
+   elm_progressbar_value_set(idesc->progress, (double)done / script->duration);
+   sprintf(buf, "ETA %u:%02u", eta / 60, eta % 60);
+   elm_object_text_set(idesc->progress, buf);
+   return EINA_TRUE;
+}
+
+#if 0
+static Eo *
+_label_create(Eo *parent, const char *text, Eo **wref)
+{
+   Eo *label = wref ? *wref : NULL;
+   if (!label)
+     {
+        label = elm_label_add(parent);
+        evas_object_size_hint_align_set(label, 0.0, EVAS_HINT_FILL);
+        evas_object_size_hint_weight_set(label, EVAS_HINT_EXPAND, 0.0);
+        evas_object_show(label);
+        if (wref) efl_wref_add(label, wref);
+     }
+   elm_object_text_set(label, text);
+   return label;
+}
+#endif
+
+static Eo *
+_button_create(Eo *parent, const char *text, Eo *icon, Eo **wref, Evas_Smart_Cb cb_func, void *cb_data)
+{
+   Eo *bt = wref ? *wref : NULL;
+   if (!bt)
+     {
+        bt = elm_button_add(parent);
+        evas_object_size_hint_align_set(bt, EVAS_HINT_FILL, EVAS_HINT_FILL);
+        evas_object_size_hint_weight_set(bt, 0.0, 0.0);
+        evas_object_show(bt);
+        if (wref) efl_wref_add(bt, wref);
+        if (cb_func) evas_object_smart_callback_add(bt, "clicked", cb_func, cb_data);
+     }
+   elm_object_text_set(bt, text);
+   elm_object_part_content_set(bt, "icon", icon);
+   return bt;
+}
+
+static Eo *
+_icon_create(Eo *parent, const char *path, Eo **wref)
+{
+   Eo *ic = wref ? *wref : NULL;
+   if (!ic)
+     {
+        ic = elm_icon_add(parent);
+        elm_icon_standard_set(ic, path);
+        evas_object_show(ic);
+        if (wref) efl_wref_add(ic, wref);
+     }
+   return ic;
+}
+
+static Eo *
+_progress_create(Eo *parent, Eo **wref)
+{
+   Eo *pb = wref ? *wref : NULL;
+   if (!pb)
+     {
+        pb = elm_progressbar_add(parent);
+        evas_object_size_hint_align_set(pb, EVAS_HINT_FILL, 0.5);
+        evas_object_size_hint_weight_set(pb, 0.0, 0.0);
+        elm_progressbar_span_size_set(pb, 100);
+        elm_progressbar_unit_format_set(pb, "%.0f %%");
+        if (wref) efl_wref_add(pb, wref);
+     }
+   return pb;
+}
+
+static char *
+_file_get_as_string(const char *filename)
+{
+   char *file_data = NULL;
+   int file_size;
+   FILE *fp = fopen(filename, "rb");
+   if (!fp)
+     {
+        PRINT("Can not open file: \"%s\".", filename);
+        return NULL;
+     }
+
+   fseek(fp, 0, SEEK_END);
+   file_size = ftell(fp);
+   if (file_size == -1)
+     {
+        fclose(fp);
+        PRINT("Can not ftell file: \"%s\".", filename);
+        return NULL;
+     }
+   rewind(fp);
+   file_data = (char *) calloc(1, file_size + 1);
+   if (!file_data)
+     {
+        fclose(fp);
+        PRINT("Calloc failed");
+        return NULL;
+     }
+   int res = fread(file_data, file_size, 1, fp);
+   fclose(fp);
+   if (!res)
+     {
+        free(file_data);
+        file_data = NULL;
+        PRINT("fread failed");
+     }
+   return file_data;
+}
+
+/*
+ * The feedback of the adaptive pacing is the repaint of the focused client
+ * by the compositor. The stand-alone app has no compositor, its own
+ * window stands in for the target.
+ */
+static Evas *
+_feedback_evas_get(Instance *inst)
+{
+#ifndef STAND_ALONE
+   (void) inst;
+   return e_comp ? e_comp->evas : NULL;
+#else
+   return inst && inst->main_box ? evas_object_evas_get(inst->main_box) : NULL;
+#endif
+}
+
+/* Object through which the clipboard is accessed */
+static Eo *
+_cnp_obj_get(Instance *inst)
+{
+#ifndef STAND_ALONE
+   (void) inst;
+   return e_comp ? e_comp->elm : NULL;
+#else
+   return inst ? inst->main_box : NULL;
+#endif
+}
+
+static Eina_Bool
+_rect_intersects_focus(const Eina_Rectangle *r)
+{
+#ifndef STAND_ALONE
+   E_Client *ec = e_client_focused_get();
+   if (!ec) return EINA_TRUE;
+   return r->x < ec->x + ec->w && ec->x < r->x + r->w &&
+      r->y < ec->y + ec->h && ec->y < r->y + r->h;
+#else
+   (void) r;
+   return EINA_TRUE;
+#endif
+}
+
+static Eina_Bool
+_play_start(Item_Desc *idesc)
+{
+   idesc->script = _script_get(idesc->filename);
+   if (!idesc->script) return EINA_FALSE;
+   idesc->device = _device_get(idesc->script->device);
+   if (!idesc->device)
+     {
+        _script_unref(idesc->script);
+        idesc->script = NULL;
+        return EINA_FALSE;
+     }
+   idesc->playing = EINA_TRUE;
+   idesc->cur_op = idesc->cur_step = 0;
+   idesc->start_time = _now_us();
+   idesc->late_sum = idesc->late_max = idesc->late_nb = 0;
+   if (idesc->script->adaptive)
+     {
+        idesc->gap = idesc->script->pace_min;
+        idesc->timeouts = 0;
+        idesc->ack_pending = idesc->stalled = EINA_FALSE;
+        idesc->feedback_evas = _feedback_evas_get(idesc->instance);
+        if (idesc->feedback_evas)
+           evas_event_callback_add(idesc->feedback_evas, EVAS_CALLBACK_RENDER_POST,
+                 _feedback_render_post_cb, idesc);
+     }
+   PRINT("Beginning consuming %s", idesc->filename);
+   _consume(idesc);
+   return EINA_TRUE;
+}
+
+static void
+_play_stop(Item_Desc *idesc)
+{
+   Script_Op *op;
+   int key;
+
+   /* No key is left pressed by an interrupted script */
+   if (idesc->script && idesc->cur_op < eina_inarray_count(idesc->script->ops))
+     {
+        op = eina_inarray_nth(idesc->script->ops, idesc->cur_op);
+        if (op->type == OP_HOLD && idesc->cur_step == 1) _send_key(idesc, op->key, 0);
+     }
+   for (key = 0; key < KEY_CNT; key++)
+     {
+        if (!BIT_TEST(idesc->keys_down, key)) continue;
+        if (idesc->device) _send_key(idesc, key, 0);
+        BIT_CLEAR(idesc->keys_down, key);
+     }
+   idesc->cur_step = 0;
+   idesc->playing = EINA_FALSE;
+   ecore_timer_del(idesc->timer);
+   idesc->timer = NULL;
+   idesc->paste_op = NULL;
+   _paste_waits = eina_list_remove(_paste_waits, idesc);
+   if (idesc->saved_clipboard)
+     {
+        /* Stopped between the paste and the restore */
+        Eo *obj = _cnp_obj_get(idesc->instance);
+        if (obj) elm_cnp_selection_set(obj, ELM_SEL_TYPE_CLIPBOARD, ELM_SEL_FORMAT_TEXT,
+              idesc->saved_clipboard, strlen(idesc->saved_clipboard));
+        free(idesc->saved_clipboard);
+        idesc->saved_clipboard = NULL;
+     }
+   if (idesc->feedback_evas)
+      evas_event_callback_del_full(idesc->feedback_evas, EVAS_CALLBACK_RENDER_POST,
+            _feedback_render_post_cb, idesc);
+   idesc->feedback_evas = NULL;
+   _script_unref(idesc->script);
+   idesc->script = NULL;
+}
+
+static void
+_start_stop_bt_clicked(void *data, Evas_Object *obj EINA_UNUSED, void *event_info EINA_UNUSED)
+{
+   Eina_List *itr;
+   Item_Desc *idesc = data, *idesc2;
+   if (idesc->playing)
+     {
+        _play_stop(idesc);
+        ecore_timer_del(idesc->progress_timer);
+        idesc->progress_timer = NULL;
+     }
+   else
+     {
+        idesc->progress_timer = ecore_timer_add(PROGRESS_INTERVAL, _progress_update, idesc);
+        /* The script may be finished when it returns */
+        if (!_play_start(idesc))
+          {
+             ecore_timer_del(idesc->progress_timer);
+             idesc->progress_timer = NULL;
+             return;
+          }
+     }
+   elm_object_part_content_set(idesc->start_button, "icon",
+      _icon_create(idesc->start_button,
+         idesc->playing ? "media-playback-stop" : "media-playback-start", NULL));
+   if (idesc->progress)
+     {
+        if (idesc->playing) evas_object_show(idesc->progress);
+        else evas_object_hide(idesc->progress);
+     }
+   EINA_LIST_FOREACH(idesc->instance->items, itr, idesc2)
+     {
+        if (idesc2 != idesc)
+           elm_object_disabled_set(idesc2->start_button, idesc->playing);
+     }
+}
+
+/*
+ * Scheduler of the scripts having a SCHEDULE line.
+ * The entries are kept in a binary min-heap ordered on their next fire
+ * time, with a single timer armed for the top one, so a fire costs
+ * O(log n) whatever the number of scheduled scripts.
+ */
+typedef struct
+{
+   Eina_Stringshare *filename;
+   Schedule sched;
+   double base; /* Next fire time before jitter, unix time */
+   double next; /* base + jitter */
+   unsigned int idx; /* Position in the heap */
+   unsigned int running;
+   unsigned int queued;
+   Eina_Bool seen : 1;
+   Eina_Bool in_heap : 1; /* Unscheduled entries are kept until their runs end */
+} Sched_Entry;
+
+static Sched_Entry **_sched_heap = NULL;
+static unsigned int _sched_nb = 0, _sched_size = 0;
+static Eina_Hash *_sched_entries = NULL;
+static Eina_List *_sched_runs = NULL; /* Item_Desc of the scheduled runs going on */
+static Ecore_Timer *_sched_timer = NULL;
+
+static void
+_sched_heap_swap(unsigned int i, unsigned int j)
+{
+   Sched_Entry *e = _sched_heap[i];
+   _sched_heap[i] = _sched_heap[j];
+   _sched_heap[j] = e;
+   _sched_heap[i]->idx = i;
+   _sched_heap[j]->idx = j;
+}
+
+static void
+_sched_heap_fix(unsigned int i)
+{
+   while (i && _sched_heap[(i - 1) / 2]->next > _sched_heap[i]->next)
+     {
+        _sched_heap_swap(i, (i - 1) / 2);
+        i = (i - 1) / 2;
+     }
+   while (1)
+     {
+        unsigned int l = 2 * i + 1, r = l + 1, min = i;
+        if (l < _sched_nb && _sched_heap[l]->next < _sched_heap[min]->next) min = l;
+        if (r < _sched_nb && _sched_heap[r]->next < _sched_heap[min]->next) min = r;
+        if (min == i) break;
+        _sched_heap_swap(i, min);
+        i = min;
+     }
+}
+
+static void
+_sched_heap_insert(Sched_Entry *e)
+{
+   if (_sched_nb == _sched_size)
+     {
+        _sched_size = _sched_size ? _sched_size * 2 : 16;
+        _sched_heap = realloc(_sched_heap, _sched_size * sizeof(*_sched_heap));
+     }
+   e->idx = _sched_nb;
+   _sched_heap[_sched_nb++] = e;
+   _sched_heap_fix(e->idx);
+}
+
+static void
+_sched_heap_remove(Sched_Entry *e)
+{
+   unsigned int i = e->idx;
+   if (i != --_sched_nb)
+     {
+        _sched_heap_swap(i, _sched_nb);
+        _sched_heap_fix(i);
+     }
+}
+
+static Eina_Bool
+_cron_match(const Schedule *sched, const struct tm *tm)
+{
+   Eina_Bool mday = !!(sched->mdays & (1U << tm->tm_mday));
+   Eina_Bool wday = !!(sched->wdays & (1U << tm->tm_wday));
+   if (!(sched->months & (1U << (tm->tm_mon + 1)))) return EINA_FALSE;
+   if (sched->mdays_any || sched->wdays_any) return mday && wday;
+   return mday || wday;
+}
+
+/* First minute after t matching the cron fields */
+static double
+_cron_next(const Schedule *sched, double t)
+{
+   time_t tt = (time_t)t + 60;
+   struct tm tm;
+   int i;
+
+   localtime_r(&tt, &tm);
+   tm.tm_sec = 0;
+   /* Bounded by a few years of non matching months and days */
+   for (i = 0; i < 5000; i++)
+     {
+        tm.tm_isdst = -1;
+        tt = mktime(&tm);
+        localtime_r(&tt, &tm);
+        if (!_cron_match(sched, &tm))
+          {
+             tm.tm_mday++;
+             tm.tm_hour = tm.tm_min = 0;
+          }
+        else if (!(sched->hours & (1U << tm.tm_hour)))
+          {
+             tm.tm_hour++;
+             tm.tm_min = 0;
+          }
+        else if (!(sched->minutes & (1ULL << tm.tm_min))) tm.tm_min++;
+        else return tt;
+     }
+   PRINT("No time matches the cron schedule");
+   return SCHED_NEVER;
+}
+
+/* Compute the next fire time, skipping the periods already elapsed */
+static void
+_sched_entry_next(Sched_Entry *e, double now)
+{
+   if (e->sched.type == SCHED_EVERY)
+     {
+        if (e->base <= now)
+           e->base += ((unsigned long long)((now - e->base) / e->sched.interval) + 1) * e->sched.interval;
+     }
+   else e->base = _cron_next(&e->sched, now);
+   e->next = e->base;
+   if (e->base < SCHED_NEVER && e->sched.jitter) e->next += rand() % (e->sched.jitter + 1);
+}
+
+static Eina_Bool _sched_fire(void *data);
+
+static void
+_sched_timer_update(void)
+{
+   double now = ecore_time_unix_get();
+   ecore_timer_del(_sched_timer);
+   _sched_timer = NULL;
+   if (!_sched_nb || _sched_heap[0]->next >= SCHED_NEVER) return;
+   _sched_timer = ecore_timer_add(_sched_heap[0]->next > now ? _sched_heap[0]->next - now : 0.0,
+         _sched_fire, NULL);
+}
+
+static void
+_sched_run(Sched_Entry *e)
+{
+   Item_Desc *idesc;
+   const char *name;
+
+   if (e->running >= e->sched.max_concurrent)
+     {
+        if (e->sched.queue_overlap && !e->queued)
+          {
+             PRINT("%s is still running, next run queued", e->filename);
+             e->queued = 1;
+          }
+        else PRINT("%s is still running, run skipped", e->filename);
+        return;
+     }
+   name = strrchr(e->filename, '/');
+   idesc = calloc(1, sizeof(*idesc));
+   idesc->filename = eina_stringshare_ref(e->filename);
+   idesc->name = eina_stringshare_add(name ? name + 1 : e->filename);
+   idesc->scheduled = EINA_TRUE;
+   e->running++;
+   _sched_runs = eina_list_append(_sched_runs, idesc);
+   /* The run may be finished and freed when it returns */
+   if (!_play_start(idesc))
+     {
+        _sched_runs = eina_list_remove(_sched_runs, idesc);
+        e->running--;
+        eina_stringshare_del(idesc->filename);
+        eina_stringshare_del(idesc->name);
+        free(idesc);
+     }
+}
+
+static void
+_sched_run_done(Item_Desc *idesc)
+{
+   Sched_Entry *e = eina_hash_find(_sched_entries, idesc->filename);
+   _sched_runs = eina_list_remove(_sched_runs, idesc);
+   _play_stop(idesc);
+   eina_stringshare_del(idesc->filename);
+   eina_stringshare_del(idesc->name);
+   free(idesc);
+   if (!e) return;
+   if (e->running) e->running--;
+   if (!e->in_heap)
+     {
+        if (!e->running) eina_hash_del_by_key(_sched_entries, e->filename);
+        return;
+     }
+   if (e->queued)
+     {
+        e->queued = 0;
+        _sched_run(e);
+     }
+}
+
+/* Stop the scheduled runs going on, their queued runs are dropped */
+static void
+_sched_runs_stop(void)
+{
+   while (_sched_runs)
+     {
+        Item_Desc *idesc = eina_list_data_get(_sched_runs);
+        Sched_Entry *e = eina_hash_find(_sched_entries, idesc->filename);
+        if (e) e->queued = 0;
+        _sched_run_done(idesc);
      }
-   return key->kernelcode;
 }
 
-#define WSKIP while (*idesc->cur_filedata == ' ') idesc->cur_filedata++;
-
 static Eina_Bool
-_consume(void *data)
+_sched_fire(void *data EINA_UNUSED)
 {
-   Item_Desc *idesc = data;
-   Instance *inst = idesc->instance;
-   if (*idesc->cur_filedata)
+   double now = ecore_time_unix_get();
+   _sched_timer = NULL;
+   while (_sched_nb && _sched_heap[0]->next <= now)
      {
-        int down = 1;
-        while (*idesc->cur_filedata == '\n')
-          {
-             idesc->cur_filedata++;
-             idesc->cur_state = NULL;
-             WSKIP;
-          }
-        if (!strncmp(idesc->cur_state ? idesc->cur_state : idesc->cur_filedata, "KEY ", 4))
-          {
-             if (!idesc->cur_state)
-               {
-                  idesc->cur_state = idesc->cur_filedata;
-                  idesc->cur_filedata += 3;
-               }
-             if (*idesc->cur_filedata == ' ')
-               {
-                  WSKIP;
-                  char *end = idesc->cur_filedata;
-                  while (*end && *end != '\n' && *end != ' ') end++;
-                  int key = _key_find_from_string(inst, idesc->cur_filedata, end - idesc->cur_filedata);
-                  idesc->cur_filedata = end;
-                  _send_key(idesc, key, 1);
-                  _send_key(idesc, key, 0);
-                  idesc->timer = ecore_timer_add(DELAY, _consume, idesc);
-                  PRINT("Key %d", key);
-                  return EINA_FALSE;
-               }
-          }
-        if (!strncmp(idesc->cur_state ? idesc->cur_state : idesc->cur_filedata, "TYPE ", 5))
+        Sched_Entry *e = _sched_heap[0];
+        if (now - e->next > SCHED_GRACE && !e->sched.run_missed)
           {
-             if (!idesc->cur_state)
-               {
-                  idesc->cur_state = idesc->cur_filedata;
-                  idesc->cur_filedata += 5;
-               }
-             char c = *idesc->cur_filedata;
-             int key = _key_find_from_char(inst, c);
-             idesc->cur_filedata++;
-             _send_key(idesc, key, 1);
-             _send_key(idesc, key, 0);
-             idesc->timer = ecore_timer_add(DELAY, _consume, idesc);
-             PRINT("Type %c", c);
-             return EINA_FALSE;
-          }
-        else if ((down = !strncmp(idesc->cur_state ? idesc->cur_state : idesc->cur_filedata, "KEY_DOWN ", 9)) ||
-              !strncmp(idesc->cur_state ? idesc->cur_state : idesc->cur_filedata, "KEY_UP ", 7))
-          {
-             if (!idesc->cur_state)
-               {
-                  idesc->cur_state = idesc->cur_filedata;
-                  idesc->cur_filedata += (down ? 8 : 6);
-               }
-             if (*idesc->cur_filedata == ' ')
-               {
-                  WSKIP;
-                  char *end = idesc->cur_filedata;
-                  while (*end && *end != '\n' && *end != ' ') end++;
-                  int key = _key_find_from_string(inst, idesc->cur_filedata, end - idesc->cur_filedata);
-                  idesc->cur_filedata = end;
-                  _send_key(idesc, key, down ? 1 : 0);
-                  idesc->timer = ecore_timer_add(DELAY, _consume, idesc);
-                  return EINA_FALSE;
-               }
-             PRINT("Key %s", down?"Down":"Up");
+             PRINT("Run of %s missed, skipped", e->filename);
           }
-        else if (!strncmp(idesc->cur_filedata, "DELAY ", 6))
+        else _sched_run(e);
+        _sched_entry_next(e, now);
+        _sched_heap_fix(e->idx);
+     }
+   _sched_timer_update();
+   return EINA_FALSE;
+}
+
+static void
+_sched_entry_free(Sched_Entry *e)
+{
+   eina_stringshare_del(e->filename);
+   free(e);
+}
+
+/* Add, update or remove (NULL script) the schedule of a script */
+static void
+_sched_entry_set(const char *filename, const Script *script)
+{
+   Sched_Entry *e = eina_hash_find(_sched_entries, filename);
+   double now = ecore_time_unix_get();
+
+   if (!script || script->sched.type == SCHED_NONE)
+     {
+        if (!e || !e->in_heap) return;
+        _sched_heap_remove(e);
+        e->in_heap = EINA_FALSE;
+        e->queued = 0;
+        /* The runs still going on are counted in it */
+        if (!e->running) eina_hash_del_by_key(_sched_entries, e->filename);
+     }
+   else if (!e || !e->in_heap || memcmp(&e->sched, &script->sched, sizeof(Schedule)))
+     {
+        /* An unchanged schedule keeps its next fire time */
+        if (!e)
           {
-             char *end = NULL;
-             idesc->cur_filedata += 6;
-             int d = strtol(idesc->cur_filedata, &end, 10);
-             idesc->cur_filedata = end;
-             WSKIP;
-             if (*idesc->cur_filedata && *idesc->cur_filedata != '\n')
-               {
-                  PRINT("DELAY expects an integer representing milliseconds");
-                  return EINA_FALSE;
-               }
-             idesc->timer = ecore_timer_add(d / 1000.0, _consume, idesc);
-             PRINT("Delay %dms", d);
-             return EINA_FALSE;
+             e = calloc(1, sizeof(*e));
+             e->filename = eina_stringshare_add(filename);
+             eina_hash_add(_sched_entries, e->filename, e);
           }
+        e->sched = script->sched;
+        e->base = now;
+        _sched_entry_next(e, now);
+        if (e->in_heap) _sched_heap_fix(e->idx);
         else
           {
-             if (*idesc->cur_filedata)
-                PRINT("Unknown token: %s", idesc->cur_filedata);
+             _sched_heap_insert(e);
+             e->in_heap = EINA_TRUE;
           }
      }
-   PRINT("Finishing consuming");
-   _start_stop_bt_clicked(idesc, NULL, NULL);
+   else return;
+   _sched_timer_update();
+}
+
+static void _items_update(Instance *inst);
+
+static Eina_Bool
+_items_refresh(void *data EINA_UNUSED)
+{
+   Eina_List *itr;
+   Instance *inst;
+   _items_refresh_timer = NULL;
+   EINA_LIST_FOREACH(_instances, itr, inst) _items_update(inst);
    return EINA_FALSE;
 }
 
-#if 0
-static Eo *
-_label_create(Eo *parent, const char *text, Eo **wref)
+/*
+ * Compilation of the scripts of the config dir on the Ecore thread pool.
+ * The results are published to the cache, the scheduler and the items
+ * from the main loop as they come.
+ */
+typedef struct
 {
-   Eo *label = wref ? *wref : NULL;
-   if (!label)
-     {
-        label = elm_label_add(parent);
-        evas_object_size_hint_align_set(label, 0.0, EVAS_HINT_FILL);
-        evas_object_size_hint_weight_set(label, EVAS_HINT_EXPAND, 0.0);
-        evas_object_show(label);
-        if (wref) efl_wref_add(label, wref);
-     }
-   elm_object_text_set(label, text);
-   return label;
+   Eina_Stringshare *filename;
+   Ecore_Thread *thread;
+   struct stat st;
+   Script *script;
+} Compile_Job;
+
+static void _compile_job_add(const char *filename);
+
+static void
+_compile_job_run(void *data, Ecore_Thread *th EINA_UNUSED)
+{
+   Compile_Job *job = data;
+   if (stat(job->filename, &job->st)) return;
+   job->script = _script_compile(job->filename);
 }
-#endif
 
-static Eo *
-_button_create(Eo *parent, const char *text, Eo *icon, Eo **wref, Evas_Smart_Cb cb_func, void *cb_data)
+static void
+_compile_job_free(Compile_Job *job)
 {
-   Eo *bt = wref ? *wref : NULL;
-   if (!bt)
-     {
-        bt = elm_button_add(parent);
-        evas_object_size_hint_align_set(bt, EVAS_HINT_FILL, EVAS_HINT_FILL);
-        evas_object_size_hint_weight_set(bt, 0.0, 0.0);
-        evas_object_show(bt);
-        if (wref) efl_wref_add(bt, wref);
-        if (cb_func) evas_object_smart_callback_add(bt, "clicked", cb_func, cb_data);
-     }
-   elm_object_text_set(bt, text);
-   elm_object_part_content_set(bt, "icon", icon);
-   return bt;
+   _script_free(job->script);
+   eina_stringshare_del(job->filename);
+   free(job);
 }
 
-static Eo *
-_icon_create(Eo *parent, const char *path, Eo **wref)
+static void
+_compile_job_cancel(void *data, Ecore_Thread *th EINA_UNUSED)
 {
-   Eo *ic = wref ? *wref : NULL;
-   if (!ic)
-     {
-        ic = elm_icon_add(parent);
-        elm_icon_standard_set(ic, path);
-        evas_object_show(ic);
-        if (wref) efl_wref_add(ic, wref);
-     }
-   return ic;
+   _compile_job_free(data);
 }
 
-static char *
-_file_get_as_string(const char *filename)
+static void
+_compile_job_end(void *data, Ecore_Thread *th EINA_UNUSED)
 {
-   char *file_data = NULL;
-   int file_size;
-   FILE *fp = fopen(filename, "rb");
-   if (!fp)
-     {
-        PRINT("Can not open file: \"%s\".", filename);
-        return NULL;
-     }
+   Compile_Job *job = data;
+   struct stat st;
 
-   fseek(fp, 0, SEEK_END);
-   file_size = ftell(fp);
-   if (file_size == -1)
+   /* Shutting down */
+   if (!_compile_jobs)
      {
-        fclose(fp);
-        PRINT("Can not ftell file: \"%s\".", filename);
-        return NULL;
+        _compile_job_free(job);
+        return;
      }
-   rewind(fp);
-   file_data = (char *) calloc(1, file_size + 1);
-   if (!file_data)
+
+   eina_hash_del_by_key(_compile_jobs, job->filename);
+   if (stat(job->filename, &st)) _sched_entry_set(job->filename, NULL);
+   else if (st.st_ino != job->st.st_ino ||
+         st.st_mtime != job->st.st_mtime || st.st_size != job->st.st_size)
      {
-        fclose(fp);
-        PRINT("Calloc failed");
-        return NULL;
+        /* Modified during the compilation */
+        _compile_job_add(job->filename);
      }
-   int res = fread(file_data, file_size, 1, fp);
-   fclose(fp);
-   if (!res)
+   else if (job->script)
      {
-        free(file_data);
-        file_data = NULL;
-        PRINT("fread failed");
+        _script_cache_add(job->filename, &job->st, job->script);
+        _sched_entry_set(job->filename, job->script);
+        job->script = NULL;
      }
-   return file_data;
+   else _sched_entry_set(job->filename, NULL);
+   _compile_job_free(job);
+
+   if (!_items_refresh_timer)
+      _items_refresh_timer = ecore_timer_add(ITEMS_REFRESH_INTERVAL, _items_refresh, NULL);
 }
 
 static void
-_start_stop_bt_clicked(void *data, Evas_Object *obj EINA_UNUSED, void *event_info EINA_UNUSED)
+_compile_job_add(const char *filename)
 {
-   Eina_List *itr;
-   Item_Desc *idesc = data, *idesc2;
-   idesc->playing = !idesc->playing;
-   elm_object_part_content_set(idesc->start_button, "icon",
-      _icon_create(idesc->start_button,
-         idesc->playing ? "media-playback-stop" : "media-playback-start", NULL));
-   if (idesc->playing)
-     {
-        idesc->filedata = _file_get_as_string(idesc->filename);
-        idesc->cur_filedata = idesc->filedata;
-        idesc->cur_state = NULL;
-        PRINT("Beginning consuming %s", idesc->filename);
-        _consume(idesc);
-     }
-   else
+   Compile_Job *job = calloc(1, sizeof(*job));
+   job->filename = eina_stringshare_add(filename);
+   eina_hash_add(_compile_jobs, job->filename, job);
+   job->thread = ecore_thread_run(_compile_job_run, _compile_job_end, _compile_job_cancel, job);
+}
+
+static Eina_Bool
+_compile_job_collect(const Eina_Hash *hash EINA_UNUSED, const void *key EINA_UNUSED,
+      void *data, void *fdata)
+{
+   Eina_List **jobs = fdata;
+   *jobs = eina_list_append(*jobs, data);
+   return EINA_TRUE;
+}
+
+static void
+_compile_jobs_stop(void)
+{
+   Eina_List *jobs = NULL;
+   Compile_Job *job;
+
+   eina_hash_foreach(_compile_jobs, _compile_job_collect, &jobs);
+   eina_hash_free(_compile_jobs);
+   _compile_jobs = NULL;
+   EINA_LIST_FREE(jobs, job)
      {
-        free(idesc->filedata);
-        idesc->filedata = idesc->cur_filedata = NULL;
-        ecore_timer_del(idesc->timer);
-        idesc->timer = NULL;
+        /* A running compilation uses the shared tables, it has to be over
+         * before they are freed. The job is freed by its end callback. */
+        if (ecore_thread_cancel(job->thread)) continue;
+        while (!ecore_thread_wait(job->thread, 1.0))
+           PRINT("Still waiting for the compilation of %s", job->filename);
      }
-   EINA_LIST_FOREACH(idesc->instance->items, itr, idesc2)
+}
+
+/*
+ * Synchronize the cache and the scheduler with the scripts of the config
+ * dir. Only the new and modified files are compiled.
+ */
+static void
+_scripts_load(void)
+{
+   Eina_List *l = ecore_file_ls(_cfg_path), *removed = NULL;
+   Sched_Entry *e;
+   unsigned int i;
+   char *file;
+
+   for (i = 0; i < _sched_nb; i++) _sched_heap[i]->seen = EINA_FALSE;
+   EINA_LIST_FREE(l, file)
      {
-        if (idesc2 != idesc)
-           elm_object_disabled_set(idesc2->start_button, idesc->playing);
+        char path[1024];
+        struct stat st;
+        Script *script;
+        if (!eina_str_has_suffix(file, ".seq"))
+          {
+             free(file);
+             continue;
+          }
+        sprintf(path, "%s/%s", _cfg_path, file);
+        free(file);
+        e = eina_hash_find(_sched_entries, path);
+        if (e) e->seen = EINA_TRUE;
+        if (eina_hash_find(_compile_jobs, path)) continue;
+        if (!stat(path, &st) && (script = _script_cached_get(path, &st)))
+           _sched_entry_set(path, script);
+        else _compile_job_add(path);
      }
+   for (i = 0; i < _sched_nb; i++)
+      if (!_sched_heap[i]->seen) removed = eina_list_append(removed, _sched_heap[i]);
+   EINA_LIST_FREE(removed, e) _sched_entry_set(e->filename, NULL);
 }
 
+
 static void
 _box_update(Instance *inst, Eina_Bool clear)
 {
@@ -421,22 +2283,27 @@ _box_update(Instance *inst, Eina_Bool clear)
               &idesc->start_button, _start_stop_bt_clicked, idesc);
         evas_object_size_hint_weight_set(idesc->start_button, EVAS_HINT_EXPAND, EVAS_HINT_EXPAND);
         elm_box_pack_end(b, idesc->start_button);
+
+        _progress_create(b, &idesc->progress);
+        elm_box_pack_end(b, idesc->progress);
+        if (idesc->playing) evas_object_show(idesc->progress);
+        else evas_object_hide(idesc->progress);
+        _progress_update(idesc);
      }
 }
 
 static void
-_config_dir_changed(void *data,
-      Ecore_File_Monitor *em EINA_UNUSED,
-      Ecore_File_Event event EINA_UNUSED, const char *_path EINA_UNUSED)
+_items_update(Instance *inst)
 {
-   Instance *inst = data;
    Eina_List *items = inst->items;
-   Eina_List *l = ecore_file_ls(inst->cfg_path);
+   Eina_List *l = ecore_file_ls(_cfg_path);
    char *file;
    Item_Desc *idesc;
    inst->items = NULL;
    EINA_LIST_FREE(l, file)
      {
+        char path[1024];
+        sprintf(path, "%s/%s", _cfg_path, file);
         if (eina_str_has_suffix(file, ".seq"))
           {
              Eina_List *itr, *itr2;
@@ -450,10 +2317,10 @@ _config_dir_changed(void *data,
                        inst->items = eina_list_append(inst->items, idesc);
                     }
                }
-             if (!found)
+             /* The new items show up once their script is compiled, the
+              * existing ones get the new script on their next play */
+             if (!found && !eina_hash_find(_compile_jobs, path))
                {
-                  char path[1024];
-                  sprintf(path, "%s/%s", inst->cfg_path, file);
                   idesc = calloc(1, sizeof(*idesc));
                   idesc->instance = inst;
                   idesc->filename = eina_stringshare_add(path);
@@ -466,11 +2333,51 @@ _config_dir_changed(void *data,
    _box_update(inst, EINA_TRUE);
    EINA_LIST_FREE(items, idesc)
      {
+        if (idesc->playing) _start_stop_bt_clicked(idesc, NULL, NULL);
         eina_stringshare_del(idesc->filename);
+        eina_stringshare_del(idesc->name);
         free(idesc);
      }
 }
 
+/*
+ * The scripts are checked against the profiles and played on their devices,
+ * so the runs are stopped and the scripts recompiled with the new ones.
+ */
+static void
+_device_profiles_reload(void)
+{
+   Eina_List *itr, *itr2;
+   Instance *inst;
+   Item_Desc *idesc;
+   char path[1024];
+
+   PRINT("Reloading the device profiles");
+   _compile_jobs_stop();
+   _compile_jobs = eina_hash_string_superfast_new(NULL);
+   _sched_runs_stop();
+   EINA_LIST_FOREACH(_instances, itr, inst)
+      EINA_LIST_FOREACH(inst->items, itr2, idesc)
+         if (idesc->playing) _start_stop_bt_clicked(idesc, NULL, NULL);
+   eina_hash_free_buckets(_scripts);
+   eina_hash_free_buckets(_devices);
+   sprintf(path, "%s/%s", _cfg_path, DEVICES_FILE);
+   _device_profiles_load(path);
+}
+
+static void
+_config_dir_changed(void *data EINA_UNUSED,
+      Ecore_File_Monitor *em EINA_UNUSED,
+      Ecore_File_Event event EINA_UNUSED, const char *path)
+{
+   Eina_List *itr;
+   Instance *inst;
+   if (path && !strcmp(ecore_file_file_get(path), DEVICES_FILE)) _device_profiles_reload();
+   else if (path) _script_uncache(path);
+   _scripts_load();
+   EINA_LIST_FOREACH(_instances, itr, inst) _items_update(inst);
+}
+
 static Eina_Bool
 _mkdir(const char *dir)
 {
@@ -486,31 +2393,107 @@ _mkdir(const char *dir)
    return EINA_TRUE;
 }
 
-static Instance *
-_instance_create()
+/* The buttons are named BTN_<button> in the scripts */
+static void
+_keys_map_init(void)
+{
+   char str[100], *s = str;
+   unsigned int i;
+
+   _keys_map = eina_hash_string_superfast_new(NULL);
+   for(i = 0; i < sizeof(kmap) / sizeof(*kmap); i++) {
+        memcpy(str, kmap[i].string, strlen(kmap[i].string) + 1);
+        eina_str_tolower(&s);
+        eina_hash_set(_keys_map, str, &(kmap[i]));
+   }
+   for (i = 0; i < sizeof(_buttons_map) / sizeof(*_buttons_map); i++)
+     {
+        snprintf(str, sizeof(str), "btn_%s", _buttons_map[i].string);
+        eina_str_tolower(&s);
+        eina_hash_set(_keys_map, str, (void *)&_buttons_map[i]);
+     }
+}
+
+static Eina_Bool
+_shared_init(void)
 {
    char path[1024];
-   Instance *inst = calloc(1, sizeof(Instance));
 
    sprintf(path, "%s/e_kinjector", efreet_config_home_get());
-   if (!_mkdir(path)) return NULL;
-   inst->cfg_path = eina_stringshare_add(path);
-   inst->config_dir_monitor = ecore_file_monitor_add(path, _config_dir_changed, inst);
+   if (!_mkdir(path)) return EINA_FALSE;
+   _cfg_path = eina_stringshare_add(path);
+   _config_dir_monitor = ecore_file_monitor_add(path, _config_dir_changed, NULL);
+
+   _keys_map_init();
+   /* Looked up with plain strings, e.g. the paths given by the monitor */
+   _scripts = eina_hash_string_superfast_new(EINA_FREE_CB(_script_unref));
+   _devices = eina_hash_string_superfast_new(EINA_FREE_CB(_device_free));
+   sprintf(path, "%s/%s", _cfg_path, DEVICES_FILE);
+   _device_profiles_load(path);
+   _sched_entries = eina_hash_string_superfast_new(EINA_FREE_CB(_sched_entry_free));
+   _compile_jobs = eina_hash_string_superfast_new(NULL);
+   return EINA_TRUE;
+}
+
+static void
+_shared_shutdown(void)
+{
+   ecore_file_monitor_del(_config_dir_monitor);
+   _config_dir_monitor = NULL;
+   _compile_jobs_stop();
+   _sched_runs_stop();
+   ecore_timer_del(_items_refresh_timer);
+   _items_refresh_timer = NULL;
+   ecore_timer_del(_sched_timer);
+   _sched_timer = NULL;
+   eina_hash_free(_sched_entries);
+   _sched_entries = NULL;
+   free(_sched_heap);
+   _sched_heap = NULL;
+   _sched_nb = _sched_size = 0;
+   eina_hash_free(_scripts);
+   _scripts = NULL;
+   eina_hash_free(_devices);
+   _devices = NULL;
+   eina_hash_free(_keys_map);
+   _keys_map = NULL;
+   eina_stringshare_del(_cfg_path);
+   _cfg_path = NULL;
+}
+
+static Instance *
+_instance_create()
+{
+   Instance *inst;
 
-   if (!_configure_dev(inst))
+   if (!_instances)
      {
-        free(inst);
-        inst = NULL;
+        if (!_shared_init()) return NULL;
+        _scripts_load();
      }
+
+   inst = calloc(1, sizeof(Instance));
+   _instances = eina_list_append(_instances, inst);
    return inst;
 }
 
 static void
 _instance_delete(Instance *inst)
 {
+   Item_Desc *idesc;
+
+   EINA_LIST_FREE(inst->items, idesc)
+     {
+        if (idesc->playing) _start_stop_bt_clicked(idesc, NULL, NULL);
+        eina_stringshare_del(idesc->filename);
+        eina_stringshare_del(idesc->name);
+        free(idesc);
+     }
    if (inst->o_icon) evas_object_del(inst->o_icon);
    if (inst->main_box) evas_object_del(inst->main_box);
 
+   _instances = eina_list_remove(_instances, inst);
+   if (!_instances) _shared_shutdown();
    free(inst);
 }
 
@@ -590,7 +2573,7 @@ _gc_init(E_Gadcon *gc, const char *name, const char *id, const char *style)
    gcc->data = inst;
    inst->gcc = gcc;
 
-   _config_dir_changed(inst, NULL, ECORE_FILE_EVENT_MODIFIED, NULL);
+   _items_update(inst);
    evas_object_event_callback_add(inst->o_icon, EVAS_CALLBACK_MOUSE_DOWN,
 				  _button_cb_mouse_down, inst);
 
@@ -691,6 +2674,82 @@ e_modapi_save(E_Module *m EINA_UNUSED)
    return 1;
 }
 #else
+/*
+ * Dry run: play a script on a virtual clock and write the events it
+ * generates into a file, as input_event records or as text.
+ * No device is needed and the delays are not waited.
+ */
+static int
+_simulate(const char *filename, const char *output, const char *devices, Eina_Bool text)
+{
+   Item_Desc idesc;
+   Device dev, *profile;
+   unsigned long long begin;
+   unsigned int i;
+   int ret = 1;
+
+   memset(&idesc, 0, sizeof(idesc));
+   /* Nothing is taken from the config dir so the output only depends on the arguments */
+   _keys_map_init();
+   _devices = eina_hash_string_superfast_new(EINA_FREE_CB(_device_free));
+   if (devices && !ecore_file_exists(devices))
+     {
+        fprintf(stderr, "Can not find %s\n", devices);
+        goto end;
+     }
+   if (!_device_profiles_load(devices))
+     {
+        fprintf(stderr, "Failed to load the profiles of %s\n", devices);
+        goto end;
+     }
+   idesc.script = _script_compile(filename);
+   if (!idesc.script)
+     {
+        fprintf(stderr, "Failed to compile %s\n", filename);
+        goto end;
+     }
+   profile = eina_hash_find(_devices,
+         idesc.script->device ? idesc.script->device : DEFAULT_PROFILE);
+   dev = *profile;
+   dev.sim = strcmp(output, "-") ? fopen(output, "wb") : stdout;
+   dev.sim_text = text;
+   dev.sim_events = 0;
+   if (!dev.sim)
+     {
+        fprintf(stderr, "Can not open %s\n", output);
+        goto end;
+     }
+   idesc.device = &dev;
+
+   /* The adaptive pacing is simulated as an always acking target */
+   begin = _now_us();
+   for (i = 0; i < eina_inarray_count(idesc.script->ops); i++)
+     {
+        Script_Op *op = eina_inarray_nth(idesc.script->ops, i);
+        unsigned int step;
+        for (step = 0; step < op->count; step++)
+          {
+             dev.clock = op->offset + (unsigned long long)step * op->stride;
+             _op_exec(&idesc, op, step);
+          }
+     }
+   if (dev.sim != stdout) fclose(dev.sim);
+
+   fprintf(stderr, "%s: %u ops, %u events, duration %llu.%06llus, simulated in %lluus\n",
+         filename, eina_inarray_count(idesc.script->ops), dev.sim_events,
+         idesc.script->duration / 1000000, idesc.script->duration % 1000000,
+         _now_us() - begin);
+   ret = 0;
+
+end:
+   _script_free(idesc.script);
+   eina_hash_free(_devices);
+   _devices = NULL;
+   eina_hash_free(_keys_map);
+   _keys_map = NULL;
+   return ret;
+}
+
 int main(int argc, char **argv)
 {
    Instance *inst;
@@ -699,14 +2758,41 @@ int main(int argc, char **argv)
    ecore_init();
    ecore_con_init();
    efreet_init();
+
+   if (argc > 2 && !strcmp(argv[1], "--simulate"))
+     {
+        const char *output = "-", *devices = NULL;
+        Eina_Bool text = EINA_FALSE;
+        int i, ret;
+        for (i = 3; i < argc; i++)
+          {
+             if (!strcmp(argv[i], "--text")) text = EINA_TRUE;
+             else if (!strcmp(argv[i], "--output") && i + 1 < argc) output = argv[++i];
+             else if (!strcmp(argv[i], "--devices") && i + 1 < argc) devices = argv[++i];
+             else
+               {
+                  fprintf(stderr, "Usage: %s --simulate <script> [--output <file>] "
+                        "[--devices <file>] [--text]\n", argv[0]);
+                  return 1;
+               }
+          }
+        /* Elementary is not initialized in this mode */
+        ecore_file_init();
+        ret = _simulate(argv[2], output, devices, text);
+        ecore_file_shutdown();
+        efreet_shutdown();
+        ecore_con_shutdown();
+        ecore_shutdown();
+        eina_shutdown();
+        return ret;
+     }
+
    elm_init(argc, argv);
 
    inst = _instance_create();
    if (!inst)
      {
-        PRINT("Failed to initialize the module\n"
-              "Did you add a rule in /etc/udev/rules.d/ to chmod 666 /dev/uinput?\n"
-              "Did you add uinput to the modules to load (/etc/modules-load.d/?");
+        PRINT("Failed to initialize the module");
         goto end;
      }
 
@@ -722,7 +2808,7 @@ int main(int argc, char **argv)
    evas_object_resize(win, 480, 480);
    evas_object_show(win);
 
-   _config_dir_changed(inst, NULL, ECORE_FILE_EVENT_MODIFIED, NULL);
+   _items_update(inst);
 
    elm_run();
 